@@ -0,0 +1,109 @@
+/*
+   Defines make-linear:
+     (define (make-linear a b)
+       (let ([calls 0])
+         (case-lambda
+          [() calls]
+          [(x)
+           (set! calls (add1 calls))
+           (+ (* a x) b)])))
+   where applying the result to no arguments reports how many times
+   it has been applied to an argument.
+
+   Like makeadder.c, this example creates a closure in C, but the
+   closure captures several values. Instead of allocating a separate
+   record and passing it as the closure data to
+   scheme_make_closed_prim_w_arity(), the captured values are stored
+   directly in the procedure object that is created by
+   scheme_make_prim_closure_w_arity(), so making a closure is a
+   single allocation.
+*/
+
+#include "escheme.h"
+
+/* A closure record is the array of values that is allocated inline
+   with a primitive closure. The first CLOSREC_SLOTS entries are
+   Scheme values; the remaining CLOSREC_WORDS entries are raw
+   machine words. A raw word is stored as a fixnum, so it is limited
+   to the fixnum range, but it can be read and updated without
+   allocating, and the GC (including 3m) skips over it without any
+   traversal procedure from us. */
+#define CLOSREC_SLOTS 2 /* a, b */
+#define CLOSREC_WORDS 1 /* calls */
+#define CLOSREC_SIZE (CLOSREC_SLOTS + CLOSREC_WORDS)
+
+#define CLOSREC_SLOT(p, i) (SCHEME_PRIM_CLOSURE_ELS(p)[i])
+#define CLOSREC_WORD(p, i) SCHEME_INT_VAL(SCHEME_PRIM_CLOSURE_ELS(p)[CLOSREC_SLOTS + (i)])
+#define CLOSREC_SET_WORD(p, i, v) (SCHEME_PRIM_CLOSURE_ELS(p)[CLOSREC_SLOTS + (i)] = scheme_make_integer(v))
+
+#define LINEAR_A_SLOT 0
+#define LINEAR_B_SLOT 1
+#define LINEAR_CALLS_WORD 0
+
+static Scheme_Object *mult, *add;
+
+/* The inner lambda. A primitive-closure function is like a regular
+   Scheme-procedure function, except that it receives the procedure
+   object itself as an extra argument, and the closure record is
+   reached through that object. */
+static Scheme_Object *sch_linear(int argc, Scheme_Object **argv, Scheme_Object *self)
+{
+  Scheme_Object *a[2];
+
+  if (!argc)
+    return scheme_make_integer(CLOSREC_WORD(self, LINEAR_CALLS_WORD));
+
+  /* Updating a raw word doesn't allocate: */
+  CLOSREC_SET_WORD(self, LINEAR_CALLS_WORD,
+		   CLOSREC_WORD(self, LINEAR_CALLS_WORD) + 1);
+
+  a[0] = CLOSREC_SLOT(self, LINEAR_A_SLOT);
+  a[1] = argv[0]; /* x */
+  a[0] = _scheme_apply(mult, 2, a);
+  a[1] = CLOSREC_SLOT(self, LINEAR_B_SLOT);
+  return _scheme_tail_apply(add, 2, a);
+}
+
+static Scheme_Object *sch_make_linear(int argc, Scheme_Object **argv)
+{
+  Scheme_Object *vals[CLOSREC_SIZE];
+
+  vals[LINEAR_A_SLOT] = argv[0];
+  vals[LINEAR_B_SLOT] = argv[1];
+  vals[CLOSREC_SLOTS + LINEAR_CALLS_WORD] = scheme_make_integer(0);
+
+  /* The values are copied into the new procedure object: */
+  return scheme_make_prim_closure_w_arity(sch_linear,
+					  CLOSREC_SIZE, vals,
+					  "linear",
+					  0, 1);
+}
+
+Scheme_Object *scheme_reload(Scheme_Env *env)
+{
+  scheme_add_global("make-linear",
+		    scheme_make_prim_w_arity(sch_make_linear,
+					     "make-linear",
+					     2, 2),
+		    env);
+
+  return scheme_void;
+}
+
+Scheme_Object *scheme_initialize(Scheme_Env *env)
+{
+  /* Look up arithmetic once, instead of on every call: */
+  scheme_register_extension_global(&mult, sizeof(Scheme_Object*));
+  mult = scheme_builtin_value("*");
+
+  scheme_register_extension_global(&add, sizeof(Scheme_Object*));
+  add = scheme_builtin_value("+");
+
+  return scheme_reload(env);
+}
+
+Scheme_Object *scheme_module_name()
+{
+  /* This extension doesn't define a module: */
+  return scheme_false;
+}
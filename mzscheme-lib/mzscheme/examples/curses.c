@@ -13,12 +13,18 @@
 
 #include "escheme.h"
 #include <curses.h>
+#include <sys/select.h>
 
 /**************************************************/
 
+/* Declared with the frame-batching support below: */
+static void invalidate_frame(void);
+
 static Scheme_Object *sch_clear(int argc, Scheme_Object **argv)
 {
   clear();
+  invalidate_frame();
+  return scheme_void;
 }
 
 static Scheme_Object *sch_put(int argc, Scheme_Object **argv)
@@ -35,17 +41,105 @@ static Scheme_Object *sch_put(int argc, Scheme_Object **argv)
   } else
     scheme_wrong_type("put", "character, string, or byte string", 0, argc, argv);
 
+  invalidate_frame();
+
   return scheme_void;
 }
 
+/* Keyboard input. Curses is in nodelay mode (see
+   scheme_initialize()), so getch() never blocks. When no key is
+   available, we let Racket's scheduler wait on stdin, so other
+   Racket threads keep running while a thread waits for a key. */
+
+static int pending_key = ERR;
+
+/* Set after getch() returns a key, since curses may have read more
+   input than that key (such as the rest of an escape sequence) into
+   its own buffer, where select() can't see it: */
+static int maybe_buffered = 0;
+
+static int stdin_ready(void)
+{
+  fd_set readfds;
+  struct timeval tv;
+
+  FD_ZERO(&readfds);
+  FD_SET(0, &readfds);
+  tv.tv_sec = 0;
+  tv.tv_usec = 0;
+  return (select(1, &readfds, NULL, NULL, &tv) > 0);
+}
+
+static int key_ready(Scheme_Object *data)
+{
+  /* The scheduler calls this function often. We avoid calling getch()
+     unless input is waiting, because getch() refreshes the screen if
+     anything has changed, which would show another thread's
+     half-drawn output (and defeat the batching of `draw-frame'). */
+  if ((pending_key == ERR) && (maybe_buffered || stdin_ready())) {
+    pending_key = getch();
+    maybe_buffered = (pending_key != ERR);
+  }
+  return (pending_key != ERR);
+}
+
+static void key_needs_wakeup(Scheme_Object *data, void *fds)
+{
+  void *fds_in, *fds_err;
+
+  /* Wake up when stdin has input or an error: */
+  fds_in = MZ_GET_FDSET(fds, 0);
+  MZ_FD_SET(0, fds_in);
+  fds_err = MZ_GET_FDSET(fds, 2);
+  MZ_FD_SET(0, fds_err);
+}
+
 static Scheme_Object *sch_get(int argc, Scheme_Object **argv)
 {
-  /* Gets keyboard input */
+  /* Gets keyboard input, blocking only the current Racket thread */
+  int c;
+
+  scheme_block_until(key_ready, key_needs_wakeup, NULL, 0);
+
+  c = pending_key;
+  pending_key = ERR;
+  return scheme_make_character(c);
+}
+
+static Scheme_Object *sch_get_nowait(int argc, Scheme_Object **argv)
+{
+  /* Gets keyboard input if any is available, #f otherwise */
   int c;
-  c = getch();
+
+  if (!key_ready(NULL))
+    return scheme_false;
+
+  c = pending_key;
+  pending_key = ERR;
   return scheme_make_character(c);
 }
 
+/* `key-evt' is a synchronizable event that is ready when a key is
+   available; its synchronization result is the event itself, and a
+   following `get' returns the key without blocking. */
+
+static Scheme_Type key_evt_type;
+static Scheme_Object *key_evt;
+
+#ifdef MZ_PRECISE_GC
+START_XFORM_SKIP;
+/* Traversal procedure for precise GC; a key event has no fields: */
+static int key_evt_size(void *p) {
+  return gcBYTES_TO_WORDS(sizeof(Scheme_Object));
+}
+END_XFORM_SKIP;
+#endif
+
+static int key_evt_ready(Scheme_Object *evt)
+{
+  return key_ready(NULL);
+}
+
 static Scheme_Object *sch_move(int argc, Scheme_Object **argv)
 {
   /* Move the output cursor */
@@ -81,6 +175,151 @@ static Scheme_Object *sch_refresh(int argc, Scheme_Object **argv)
 
 /**************************************************/
 
+/* Drawing a screen with `move' and `put' takes a call into C for
+   every piece of text. Instead, `draw-frame' accepts a whole frame at
+   once as a vector of commands, where each command is a vector
+
+       (vector row col str)  or  (vector row col str attr)
+
+   with `str' as a string or byte string, and `attr' as a combination
+   of the `attr-...' values (combined with `bitwise-ior'). Anything
+   not covered by a command is blank.
+
+   We keep the previous frame in C, so only cells that changed since
+   the last `draw-frame' are sent to curses, followed by a single
+   refresh(). Using `clear' or `put' in between is allowed, but it
+   makes the next `draw-frame' redraw every cell. */
+
+static chtype *frame, *prev_frame;
+static int frame_w, frame_h;
+
+#define NO_CELL ((chtype)-1)
+
+static void invalidate_frame(void)
+{
+  int i;
+
+  if (prev_frame) {
+    for (i = frame_w * frame_h; i--; ) {
+      prev_frame[i] = NO_CELL;
+    }
+  }
+}
+
+static void size_frame(void)
+{
+  int w, h;
+
+  w = getmaxx(stdscr);
+  h = getmaxy(stdscr);
+
+  if (!frame || (w != frame_w) || (h != frame_h)) {
+    /* The frames contain no Scheme values, so they're malloc()ed
+       instead of allocated by the GC: */
+    free(frame);
+    free(prev_frame);
+    frame = (chtype *)malloc(sizeof(chtype) * w * h);
+    prev_frame = (chtype *)malloc(sizeof(chtype) * w * h);
+    if (!frame || !prev_frame) {
+      free(frame);
+      free(prev_frame);
+      frame = prev_frame = NULL;
+      scheme_raise_exn(MZEXN_FAIL, "draw-frame: out of memory");
+    }
+    frame_w = w;
+    frame_h = h;
+    invalidate_frame();
+  }
+}
+
+static Scheme_Object *sch_draw_frame(int argc, Scheme_Object **argv)
+{
+  Scheme_Object *cmd = NULL, *str = NULL;
+  chtype *t;
+  char *s;
+  intptr_t n, i, j, len, row, col;
+  int attr, x, y, cx, cy;
+  MZ_GC_DECL_REG(3);
+
+  if (!SCHEME_VECTORP(argv[0]))
+    scheme_wrong_type("draw-frame", "vector", 0, argc, argv);
+
+  MZ_GC_VAR_IN_REG(0, argv);
+  MZ_GC_VAR_IN_REG(1, cmd);
+  MZ_GC_VAR_IN_REG(2, str);
+  MZ_GC_REG();
+
+  size_frame();
+
+  for (i = frame_w * frame_h; i--; ) {
+    frame[i] = ' ';
+  }
+
+  n = SCHEME_VEC_SIZE(argv[0]);
+  for (i = 0; i < n; i++) {
+    cmd = SCHEME_VEC_ELS(argv[0])[i];
+    if (!SCHEME_VECTORP(cmd)
+        || (SCHEME_VEC_SIZE(cmd) < 3)
+        || (SCHEME_VEC_SIZE(cmd) > 4)
+        || !SCHEME_INTP(SCHEME_VEC_ELS(cmd)[0])
+        || !SCHEME_INTP(SCHEME_VEC_ELS(cmd)[1])
+        || ((SCHEME_VEC_SIZE(cmd) == 4)
+            && !SCHEME_INTP(SCHEME_VEC_ELS(cmd)[3])))
+      scheme_arg_mismatch("draw-frame", "bad draw command: ", cmd);
+
+    str = SCHEME_VEC_ELS(cmd)[2];
+    if (SCHEME_CHAR_STRINGP(str))
+      str = scheme_char_string_to_byte_string(str);
+    else if (!SCHEME_BYTE_STRINGP(str))
+      scheme_arg_mismatch("draw-frame", "bad string in draw command: ", cmd);
+
+    row = SCHEME_INT_VAL(SCHEME_VEC_ELS(cmd)[0]);
+    col = SCHEME_INT_VAL(SCHEME_VEC_ELS(cmd)[1]);
+    attr = ((SCHEME_VEC_SIZE(cmd) == 4)
+            ? SCHEME_INT_VAL(SCHEME_VEC_ELS(cmd)[3])
+            : 0);
+
+    if ((row < 0) || (row >= frame_h))
+      continue;
+
+    /* Clip to the screen: */
+    s = SCHEME_BYTE_STR_VAL(str);
+    len = SCHEME_BYTE_STRTAG_VAL(str);
+    for (j = 0; j < len; j++) {
+      if ((col + j >= 0) && (col + j < frame_w))
+        frame[row * frame_w + col + j] = (((unsigned char *)s)[j] | attr);
+    }
+  }
+
+  MZ_GC_UNREG();
+
+  /* Send only the changed cells, and move the cursor only when the
+     next changed cell isn't where addch() left it: */
+  cx = cy = -1;
+  for (y = 0; y < frame_h; y++) {
+    for (x = 0; x < frame_w; x++) {
+      i = y * frame_w + x;
+      if (frame[i] != prev_frame[i]) {
+        if ((x != cx) || (y != cy))
+          move(y, x);
+        addch(frame[i]);
+        cx = x + 1;
+        cy = y;
+      }
+    }
+  }
+
+  refresh();
+
+  t = prev_frame;
+  prev_frame = frame;
+  frame = t;
+
+  return scheme_void;
+}
+
+/**************************************************/
+
 Scheme_Object *scheme_reload(Scheme_Env *env)
 {
   /* The MZ_GC... lines are for for 3m, because env is live across an
@@ -102,6 +341,11 @@ Scheme_Object *scheme_reload(Scheme_Env *env)
   v = scheme_make_prim_w_arity(sch_get, "get", 0, 0);
   scheme_add_global("get", v, env);
 
+  v = scheme_make_prim_w_arity(sch_get_nowait, "get/nowait", 0, 0);
+  scheme_add_global("get/nowait", v, env);
+
+  scheme_add_global("key-evt", key_evt, env);
+
   v = scheme_make_prim_w_arity(sch_move, "move", 2, 2);
   scheme_add_global("move", v, env);
 
@@ -111,6 +355,13 @@ Scheme_Object *scheme_reload(Scheme_Env *env)
   v = scheme_make_prim_w_arity(sch_refresh, "refresh", 0, 0);
   scheme_add_global("refresh", v, env);
 
+  v = scheme_make_prim_w_arity(sch_draw_frame, "draw-frame", 1, 1);
+  scheme_add_global("draw-frame", v, env);
+
+  scheme_add_global("attr-bold", scheme_make_integer(A_BOLD), env);
+  scheme_add_global("attr-underline", scheme_make_integer(A_UNDERLINE), env);
+  scheme_add_global("attr-reverse", scheme_make_integer(A_REVERSE), env);
+
   MZ_GC_UNREG();
 
   return scheme_void;
@@ -118,12 +369,32 @@ Scheme_Object *scheme_reload(Scheme_Env *env)
 
 Scheme_Object *scheme_initialize(Scheme_Env *env)
 {
+  /* The allocations below can trigger a GC, so register `env': */
+  MZ_GC_DECL_REG(1);
+  MZ_GC_VAR_IN_REG(0, env);
+
+  MZ_GC_REG();
+
   /* The first time we're loaded, initialize the screen: */
   initscr();
   cbreak();
   noecho();
+  nodelay(stdscr, TRUE);
   atexit(endwin);
 
+  /* Create the keyboard event type and its single instance: */
+  key_evt_type = scheme_make_type("<key-evt>");
+#ifdef MZ_PRECISE_GC
+  GC_register_traversers(key_evt_type, key_evt_size, key_evt_size, key_evt_size, 1, 0);
+#endif
+  scheme_add_evt(key_evt_type, key_evt_ready, key_needs_wakeup, NULL, 0);
+
+  scheme_register_extension_global(&key_evt, sizeof(Scheme_Object*));
+  key_evt = (Scheme_Object *)scheme_malloc_small_tagged(sizeof(Scheme_Object));
+  key_evt->type = key_evt_type;
+
+  MZ_GC_UNREG();
+
   /* Then do the usual stuff: */
   return scheme_reload(env);
 }
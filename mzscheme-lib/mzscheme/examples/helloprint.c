@@ -1,7 +1,141 @@
 /* Like hello.c, but prints to the current output port and returns
-   (void). */
+   (void). Also defines `print-table', which shows how to print a lot
+   of output from C efficiently. */
 
 #include "escheme.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**************************************************/
+
+/* Printing with scheme_display() needs a Scheme value for each piece
+   of output, so printing many numbers or lines that way allocates a
+   string or number for each one. A Port_Writer, instead, collects
+   raw bytes in a C buffer and sends them to the port in large
+   chunks with scheme_put_byte_string(). Get the port once, use the
+   pw_...() functions to add output, and call pw_flush() at the end.
+
+   The buffer contains no Scheme values, so a Port_Writer can live on
+   the C stack, even for 3m. */
+
+#define PORT_WRITER_SIZE 4096
+
+typedef struct {
+  const char *who;
+  intptr_t pos;
+  char buf[PORT_WRITER_SIZE];
+} Port_Writer;
+
+static void pw_init(Port_Writer *w, const char *who)
+{
+  w->who = who;
+  w->pos = 0;
+}
+
+static void pw_flush(Port_Writer *w, Scheme_Object *port)
+{
+  if (w->pos) {
+    scheme_put_byte_string(w->who, port, w->buf, 0, w->pos, 0);
+    w->pos = 0;
+  }
+}
+
+static void pw_bytes(Port_Writer *w, Scheme_Object *port, const char *s, intptr_t len)
+{
+  if (w->pos + len > PORT_WRITER_SIZE)
+    pw_flush(w, port);
+
+  if (len > PORT_WRITER_SIZE) {
+    /* Too big to buffer, so write it directly: */
+    scheme_put_byte_string(w->who, port, s, 0, len, 0);
+  } else {
+    memcpy(w->buf + w->pos, s, len);
+    w->pos += len;
+  }
+}
+
+static void pw_string(Port_Writer *w, Scheme_Object *port, const char *s)
+{
+  pw_bytes(w, port, s, strlen(s));
+}
+
+static void pw_fixnum(Port_Writer *w, Scheme_Object *port, intptr_t v)
+{
+  char tmp[32];
+  int len;
+
+  len = sprintf(tmp, "%" PRIdPTR, v);
+  pw_bytes(w, port, tmp, len);
+}
+
+static void pw_double(Port_Writer *w, Scheme_Object *port, double d)
+{
+  char tmp[40];
+  int len, digits;
+
+  if (d != d) {
+    pw_string(w, port, "+nan.0");
+    return;
+  } else if ((d - d) != 0.0) {
+    pw_string(w, port, (d > 0) ? "+inf.0" : "-inf.0");
+    return;
+  }
+
+  /* Print the shortest form that reads back as the same number: */
+  for (digits = 15; digits < 17; digits++) {
+    len = sprintf(tmp, "%.*g", digits, d);
+    if (strtod(tmp, NULL) == d)
+      break;
+  }
+  if (digits == 17)
+    len = sprintf(tmp, "%.17g", d);
+
+  /* Make sure that it looks like a flonum, as Racket prints it: */
+  if (!strpbrk(tmp, ".e")) {
+    tmp[len++] = '.';
+    tmp[len++] = '0';
+  }
+
+  pw_bytes(w, port, tmp, len);
+}
+
+/* (print-table rows cols) prints a table of `rows' lines, each with
+   `cols' comma-separated columns. Each column holds a row's index,
+   and the index divided by the column number as a flonum. */
+static Scheme_Object *print_table(int argc, Scheme_Object **argv)
+{
+  Scheme_Object *port;
+  Port_Writer w;
+  intptr_t rows, cols, i, j;
+
+  if (!SCHEME_INTP(argv[0]) || (SCHEME_INT_VAL(argv[0]) < 0))
+    scheme_wrong_type("print-table", "non-negative fixnum", 0, argc, argv);
+  if (!SCHEME_INTP(argv[1]) || (SCHEME_INT_VAL(argv[1]) < 0))
+    scheme_wrong_type("print-table", "non-negative fixnum", 1, argc, argv);
+
+  rows = SCHEME_INT_VAL(argv[0]);
+  cols = SCHEME_INT_VAL(argv[1]);
+
+  /* Get the port just once: */
+  port = scheme_get_param(scheme_current_config(), MZCONFIG_OUTPUT_PORT);
+
+  pw_init(&w, "print-table");
+  for (i = 0; i < rows; i++) {
+    pw_fixnum(&w, port, i);
+    for (j = 1; j <= cols; j++) {
+      pw_bytes(&w, port, ",", 1);
+      pw_double(&w, port, (double)i / (double)j);
+    }
+    pw_bytes(&w, port, "\n", 1);
+  }
+  pw_flush(&w, port);
+
+  return scheme_void;
+}
+
+/**************************************************/
 
 Scheme_Object *scheme_reload(Scheme_Env *env)
 {
@@ -19,6 +153,12 @@ Scheme_Object *scheme_reload(Scheme_Env *env)
      the current output port. But sometimes printf() is what you
      want. */
 
+  scheme_add_global("print-table",
+		    scheme_make_prim_w_arity(print_table,
+					     "print-table",
+					     2, 2),
+		    env);
+
   return scheme_void;
 }
 
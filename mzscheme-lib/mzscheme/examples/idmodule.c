@@ -3,7 +3,8 @@
   The extension is equivalent to Scheme source of them form:
     (module idmodule mzscheme
       (define (identity x) x)
-      (provide identity))
+      (define (ignore . args) (void))
+      (provide identity ignore))
 */
 
 #include "escheme.h"
@@ -13,18 +14,55 @@ static Scheme_Object *id(int argc, Scheme_Object **argv)
   return argv[0];
 }
 
+static Scheme_Object *ignore(int argc, Scheme_Object **argv)
+{
+  return scheme_void;
+}
+
+/* The exports are described by a static table, instead of a
+   sequence of calls, so that a module with many primitives is
+   described by data rather than code. A maximum arity of -1 means
+   that any number of extra arguments are allowed. */
+typedef struct {
+  const char *name;
+  Scheme_Prim *proc;
+  int mina, maxa;
+} Prim_Export;
+
+static const Prim_Export exports[] = {
+  { "identity", id, 1, 1 },
+  { "ignore", ignore, 0, -1 }
+};
+
+#define NUM_EXPORTS ((int)(sizeof(exports) / sizeof(Prim_Export)))
+
+/* The primitive objects made from the table, so that a reload (i.e.,
+   declaring the module in another namespace) doesn't create them
+   again: */
+static Scheme_Object **export_vals;
+
 Scheme_Object *scheme_reload(Scheme_Env *env)
 {
   Scheme_Env *menv;
   Scheme_Object *proc;
+  int i;
 
   menv = scheme_primitive_module(scheme_intern_symbol("idmodule"),
 				 env);
 
-  proc = scheme_make_prim_w_arity(id, "identity", 1, 1);
+  for (i = 0; i < NUM_EXPORTS; i++) {
+    proc = export_vals[i];
+    if (!proc) {
+      proc = scheme_make_prim_w_arity(exports[i].proc,
+				      exports[i].name,
+				      exports[i].mina,
+				      exports[i].maxa);
+      export_vals[i] = proc;
+    }
 
-  /* All added names are automatically exported by the module: */
-  scheme_add_global("identity", proc, menv);
+    /* All added names are automatically exported by the module: */
+    scheme_add_global(exports[i].name, proc, menv);
+  }
 
   scheme_finish_primitive_module(menv);
 
@@ -33,7 +71,11 @@ Scheme_Object *scheme_reload(Scheme_Env *env)
 
 Scheme_Object *scheme_initialize(Scheme_Env *env)
 {
-  /* First load is same as every load: */
+  /* Register the static variable with the GC before allocating
+     the array that it refers to: */
+  scheme_register_extension_global(&export_vals, sizeof(Scheme_Object**));
+  export_vals = (Scheme_Object **)scheme_malloc(NUM_EXPORTS * sizeof(Scheme_Object*));
+
   return scheme_reload(env);
 }
 